@@ -1,29 +1,20 @@
 #include <iostream>
 #include <math.h>
 
-int Calcsn(int n, long int s1, long int &nN, float& a)
+long int Calcsn(int n, long int s1, long int &nN, float& a)
 {
-	long int si,si0,sn,sSum;
-	
-	sSum = s1;
-	si0 = 0;
-	for(int i=2; i<=n; i++)
-	{
-		si = 0.5*(s1 + std::sqrt(pow(s1,2)+4*s1*sSum));
-		sSum += si;
-		a = float(si)/float(sSum);
-		
-	}
-	
-	sSum = s1;
-	si0 = 0;
+	// s_1 and alpha = 1 in the first iteration
+	long int si = s1;
+	long int sSum = s1;
+	a = 1.0;
+
 	for(int i=2; i<=n; i++)
 	{
-		si = 0.5*(s1 + sqrt(pow(s1,2)+4*s1*sSum));
+		si = 0.5*(s1 + std::sqrt(double(s1)*double(s1) + 4.0*double(s1)*double(sSum)));
 		sSum += si;
 		a = float(si)/float(sSum);
-		
 	}
+
 	nN = si;
 	return si;
 }
@@ -36,10 +27,10 @@ int main(int argc, char* argv[]) {
 	long int initN = 80000;
 	long int nNeutrons = initN;
 	float alpha = 1.0;
-	if(argc >= 2)
+	if(argc >= 3)
 	{
 		loops = std::stoi(argv[1]);
-		initN = std::stoi(argv[2]);
+		initN = std::stol(argv[2]);
 	}
 	else
 	{
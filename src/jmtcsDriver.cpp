@@ -0,0 +1,874 @@
+// JMTCS - native driver of the Serpent-OpenFOAM Picard loop
+//
+// Does the same as jmtcs_core.sh but overlaps independent stages:
+//  - the first decomposition of the mesh and 0/ runs together with Serpent
+//  - the Serpent input and interface files of the next iteration are
+//    prepared (and neutronSchedule run) while reconstructPar finishes
+// It stops early when convergenceMonitor reports convergence and writes
+// a JSON timeline with the wall time of every stage, both for
+// the iteration (<i>/timeline.json) and for the whole run (timeline.json).
+//
+// Compile:
+//     g++ -std=c++17 -O2 -pthread jmtcsDriver.cpp -o jmtcsDriver
+// Run in the directory with settings.sh:
+//     jmtcsDriver [-s settings.sh]
+
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <regex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+using Clock = std::chrono::steady_clock;
+
+
+// Settings read from settings.sh
+struct Settings
+{
+	int nLoops = 0;
+	int nProcs = 0;
+	long nInitNeutrons = 0;
+	int openfoamIterations = 0;
+	std::string openfoamFolder;
+	std::string serpentInput;
+	std::string serpent;
+	std::string openfoamSource;
+	std::vector<std::string> fuelOpenfoam;
+	std::vector<std::string> fuelIfc;
+	std::vector<std::string> coolantIfc;
+	std::string relaxAcceleration;
+	std::string targetRelErr;
+	std::string neutronBudget;
+};
+
+
+// Wall time of one stage
+struct Stage
+{
+	std::string name;
+	double start;
+	double end;
+};
+
+
+// Stages of all iterations, stages may run concurrently
+class Timeline
+{
+	Clock::time_point t0_ = Clock::now();
+	std::mutex mutex_;
+	std::vector<std::vector<Stage>> iterations_;
+
+public:
+
+	double now() const
+	{
+		return std::chrono::duration<double>(Clock::now() - t0_).count();
+	}
+
+	void add(int iter, const std::string& name, double start, double end)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (int(iterations_.size()) < iter)
+		{
+			iterations_.resize(iter);
+		}
+		iterations_[iter-1].push_back({name, start, end});
+	}
+
+	static void writeIteration(std::ostream& os, int iter, const std::vector<Stage>& stages)
+	{
+		double start = 0, end = 0;
+		if (!stages.empty())
+		{
+			start = stages.front().start;
+			for (const Stage& s : stages)
+			{
+				start = std::min(start, s.start);
+				end = std::max(end, s.end);
+			}
+		}
+
+		os << std::fixed << std::setprecision(3)
+			<< "{\"iteration\": " << iter
+			<< ", \"start\": " << start
+			<< ", \"wall\": " << end - start
+			<< ", \"stages\": [";
+		for (size_t j=0; j<stages.size(); j++)
+		{
+			const Stage& s = stages[j];
+			os << (j ? ", " : "")
+				<< "{\"name\": \"" << s.name << "\""
+				<< ", \"start\": " << s.start
+				<< ", \"end\": " << s.end
+				<< ", \"wall\": " << s.end - s.start << "}";
+		}
+		os << "]}";
+	}
+
+	// Write the iteration into its directory and the whole run into file
+	void write(int iter, const fs::path& iterFile, const fs::path& file)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		{
+			std::ofstream os(iterFile);
+			writeIteration(os, iter, iterations_[iter-1]);
+			os << "\n";
+		}
+		std::ofstream os(file);
+		os << "[\n";
+		for (size_t i=0; i<iterations_.size(); i++)
+		{
+			os << "  ";
+			writeIteration(os, i+1, iterations_[i]);
+			os << (i+1 < iterations_.size() ? ",\n" : "\n");
+		}
+		os << "]\n";
+	}
+};
+
+
+// Runs one stage and records its wall time
+class StageTimer
+{
+	Timeline& timeline_;
+	int iter_;
+	std::string name_;
+	double start_;
+
+public:
+
+	StageTimer(Timeline& timeline, int iter, const std::string& name)
+	:
+		timeline_(timeline),
+		iter_(iter),
+		name_(name),
+		start_(timeline.now())
+	{}
+
+	~StageTimer()
+	{
+		timeline_.add(iter_, name_, start_, timeline_.now());
+	}
+};
+
+
+std::string trim(const std::string& s)
+{
+	const size_t b = s.find_first_not_of(" \t\r\n");
+	if (b == std::string::npos)
+	{
+		return "";
+	}
+	const size_t e = s.find_last_not_of(" \t\r\n");
+	return s.substr(b, e - b + 1);
+}
+
+
+std::string unquote(const std::string& s)
+{
+	if (s.size() >= 2 && (s.front() == '"' || s.front() == '\'') && s.back() == s.front())
+	{
+		return s.substr(1, s.size() - 2);
+	}
+	return s;
+}
+
+
+// Values of a bash array ("a" "b") or of a single value
+std::vector<std::string> splitValues(const std::string& value)
+{
+	std::vector<std::string> values;
+	std::string v = trim(value);
+	if (!v.empty() && v.front() == '(' && v.back() == ')')
+	{
+		v = v.substr(1, v.size() - 2);
+	}
+	std::istringstream is(v);
+	std::string word;
+	while (is >> word)
+	{
+		values.push_back(unquote(word));
+	}
+	return values;
+}
+
+
+// Read KEY=value lines of settings.sh
+bool readSettings(const fs::path& file, Settings& s)
+{
+	std::ifstream is(file);
+	if (!is.good())
+	{
+		std::cerr << file.string() << " not found\n";
+		return false;
+	}
+	std::cout << "Reading settings from " << file.string() << "\n";
+
+	std::map<std::string, std::string> entries;
+	std::string line;
+	while (std::getline(is, line))
+	{
+		line = trim(line);
+		if (line.empty() || line[0] == '#')
+		{
+			continue;
+		}
+		const size_t eq = line.find('=');
+		if (eq == std::string::npos)
+		{
+			continue;
+		}
+		entries[trim(line.substr(0, eq))] = trim(line.substr(eq + 1));
+	}
+
+	auto get = [&entries](const std::string& key)
+	{
+		auto iter = entries.find(key);
+		return iter == entries.end() ? std::string() : unquote(iter->second);
+	};
+	auto getList = [&entries](const std::string& key)
+	{
+		auto iter = entries.find(key);
+		return iter == entries.end() ? std::vector<std::string>() : splitValues(iter->second);
+	};
+
+	try
+	{
+		s.nLoops = std::stoi(get("N_LOOPS"));
+		s.nProcs = std::stoi(get("N_PROCS"));
+		s.nInitNeutrons = std::stol(get("N_INIT_NEUTRONS"));
+		s.openfoamIterations = std::stoi(get("OPENFOAM_ITERATIONS"));
+	}
+	catch (const std::exception&)
+	{
+		std::cerr << "N_LOOPS, N_PROCS, N_INIT_NEUTRONS or OPENFOAM_ITERATIONS is not set\n";
+		return false;
+	}
+	s.openfoamFolder = get("OPENFOAM_FOLDER");
+	s.serpentInput = get("SERPENT_INPUT");
+	s.serpent = get("SERPENT");
+	s.openfoamSource = get("OPENFOAM_SOURCE");
+	s.fuelOpenfoam = getList("FUEL_OPENFOAM");
+	s.fuelIfc = getList("FUEL_IFC");
+	s.coolantIfc = getList("COOLANT_IFC");
+	s.relaxAcceleration = get("RELAX_ACCELERATION");
+	s.targetRelErr = get("TARGET_RELERR");
+	s.neutronBudget = get("NEUTRON_BUDGET");
+
+	std::cout << "\nChecking settings\n";
+	const long cores = sysconf(_SC_NPROCESSORS_ONLN);
+	if (s.nLoops <= 0)
+	{
+		std::cerr << "N_LOOPS is not set or is less than 0\n";
+		return false;
+	}
+	if (s.nProcs <= 0 || s.nProcs > cores)
+	{
+		std::cerr << "N_PROCS is not set or is less than 0 or greater than number of cores\n";
+		return false;
+	}
+	if (s.nInitNeutrons <= 0)
+	{
+		std::cerr << "N_INIT_NEUTRONS is not set or is less than 0\n";
+		return false;
+	}
+	if (s.openfoamIterations <= 0)
+	{
+		std::cerr << "OPENFOAM_ITERATIONS is not set or is less than 0\n";
+		return false;
+	}
+	if (!fs::is_regular_file(s.serpent))
+	{
+		std::cerr << "SERPENT executable not found or is not set\n";
+		return false;
+	}
+	if (!fs::is_regular_file(s.serpentInput + ".orig"))
+	{
+		std::cerr << "SERPENT_INPUT file not found or is not set\n";
+		return false;
+	}
+	if (!fs::is_regular_file(s.openfoamSource))
+	{
+		std::cerr << "OpenFOAM bashrc not found or is not set\n";
+		return false;
+	}
+	if (!fs::is_directory(s.openfoamFolder))
+	{
+		std::cerr << "OPENFOAM_FOLDER case not found\n";
+		return false;
+	}
+	for (const std::string& f : s.fuelIfc)
+	{
+		if (!fs::is_regular_file(f + ".orig"))
+		{
+			std::cerr << "File " << f << ".orig not found\n";
+			return false;
+		}
+	}
+	std::cout << "\nSettings read successfull\n\n";
+	return true;
+}
+
+
+// OpenFOAM environment prefix, empty when the environment is already set
+std::string foamEnv(const Settings& s)
+{
+	if (std::getenv("WM_PROJECT_DIR"))
+	{
+		return "";
+	}
+	return ". '" + s.openfoamSource + "' > /dev/null 2>&1; ";
+}
+
+
+// Run a shell command in the directory, returns its exit status
+int run(const std::string& command, const fs::path& dir = ".")
+{
+	std::cout.flush();
+	const pid_t pid = fork();
+	if (pid < 0)
+	{
+		return -1;
+	}
+	if (pid == 0)
+	{
+		if (chdir(dir.c_str()) != 0)
+		{
+			_exit(127);
+		}
+		execl("/bin/bash", "bash", "-c", command.c_str(), static_cast<char*>(nullptr));
+		_exit(127);
+	}
+
+	int status = 0;
+	if (waitpid(pid, &status, 0) < 0)
+	{
+		return -1;
+	}
+	return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+
+std::string readFile(const fs::path& file)
+{
+	std::ifstream is(file);
+	std::ostringstream os;
+	os << is.rdbuf();
+	return os.str();
+}
+
+
+void writeFile(const fs::path& file, const std::string& text)
+{
+	std::ofstream os(file);
+	os << text;
+}
+
+
+void replaceAll(std::string& text, const std::string& from, const std::string& to)
+{
+	for (size_t pos = text.find(from); pos != std::string::npos; pos = text.find(from, pos + to.size()))
+	{
+		text.replace(pos, from.size(), to);
+	}
+}
+
+
+// Latest time directory of the case, 0 if there is none
+std::string latestTime(const fs::path& caseDir)
+{
+	std::string latest = "0";
+	double latestValue = 0;
+	for (const auto& entry : fs::directory_iterator(caseDir))
+	{
+		if (!entry.is_directory())
+		{
+			continue;
+		}
+		const std::string name = entry.path().filename().string();
+		char* end = nullptr;
+		const double value = std::strtod(name.c_str(), &end);
+		if (end != name.c_str() && *end == '\0' && value >= latestValue)
+		{
+			latest = name;
+			latestValue = value;
+		}
+	}
+	return latest;
+}
+
+
+// Set an entry of system/controlDict
+void setControlDict(const fs::path& caseDir, const std::string& key, const std::string& value)
+{
+	const fs::path file = caseDir/"system"/"controlDict";
+	std::string text = readFile(file);
+	const std::regex entry("\\n[ \\t]*" + key + "[ \\t]+([^;]*);");
+	std::smatch match;
+	if (std::regex_search(text, match, entry))
+	{
+		text.replace(match.position(1), match.length(1), value);
+	}
+	else
+	{
+		text += key + " " + value + ";\n";
+	}
+	writeFile(file, text);
+}
+
+
+// Plan of neutronSchedule
+struct Plan
+{
+	std::string neutrons;
+	std::string alpha;
+};
+
+
+bool schedule(const Settings& s, int iter, Plan& plan)
+{
+	std::ostringstream cmd;
+	cmd << foamEnv(s) << "neutronSchedule -case '" << s.openfoamFolder << "'"
+		<< " -loop " << iter
+		<< " -initNeutrons " << s.nInitNeutrons
+		<< " -loops " << s.nLoops
+		<< " -regions '(";
+	for (const std::string& r : s.fuelOpenfoam)
+	{
+		cmd << r << " ";
+	}
+	cmd << ")'";
+	if (!s.targetRelErr.empty())
+	{
+		cmd << " -targetRelErr " << s.targetRelErr;
+	}
+	if (!s.neutronBudget.empty())
+	{
+		cmd << " -budget " << s.neutronBudget;
+	}
+	cmd << " > log.neutronSchedule 2>&1";
+
+	if (run(cmd.str()) != 0)
+	{
+		std::cerr << "neutronSchedule failed, check log.neutronSchedule\n";
+		return false;
+	}
+
+	std::ifstream is(fs::path(s.openfoamFolder)/"neutronPlan");
+	std::string key, value;
+	while (is >> key >> value)
+	{
+		if (key == "neutrons")
+		{
+			plan.neutrons = value;
+		}
+		else if (key == "alpha")
+		{
+			plan.alpha = value;
+		}
+	}
+	return !plan.neutrons.empty() && !plan.alpha.empty();
+}
+
+
+// Interface files with the time of the OpenFOAM fields
+void prepareIfc(const Settings& s, const std::string& time)
+{
+	for (const auto* files : {&s.fuelIfc, &s.coolantIfc})
+	{
+		for (const std::string& f : *files)
+		{
+			std::string text = readFile(f + ".orig");
+			replaceAll(text, "TIME", time);
+			writeFile(f, text);
+		}
+	}
+}
+
+
+// Serpent input with the planned neutrons
+void prepareInput(const Settings& s, int iter, const Plan& plan)
+{
+	std::string text = readFile(s.serpentInput + ".orig");
+	replaceAll(text, "NEUTRONS", plan.neutrons);
+	replaceAll(text, iter == 1 ? "%FIRST_STEP" : "%SECOND_STEP", "");
+	writeFile(s.serpentInput, text);
+}
+
+
+// Schedule neutrons and write the Serpent input and interface files
+bool prepareSerpent(const Settings& s, int iter, const std::string& time, Plan& plan)
+{
+	if (!schedule(s, iter, plan))
+	{
+		return false;
+	}
+	prepareIfc(s, time);
+	prepareInput(s, iter, plan);
+	return true;
+}
+
+
+void copyGlob(const fs::path& dir, const std::string& prefix, const fs::path& target)
+{
+	for (const auto& entry : fs::directory_iterator(dir))
+	{
+		const std::string name = entry.path().filename().string();
+		if (entry.is_regular_file() && name.compare(0, prefix.size(), prefix) == 0)
+		{
+			fs::copy_file(entry.path(), target/name, fs::copy_options::overwrite_existing);
+		}
+	}
+}
+
+
+// Power and the latest T and rho of all regions into <i>/<region>
+void copyFields(const Settings& s, const fs::path& caseDir, const std::string& time, const fs::path& iterDir)
+{
+	for (const std::string& r : s.fuelOpenfoam)
+	{
+		fs::create_directories(iterDir/r);
+		fs::copy_file(caseDir/"constant"/r/"volPower", iterDir/r/"volPower", fs::copy_options::overwrite_existing);
+	}
+	for (const auto& entry : fs::directory_iterator(caseDir/time))
+	{
+		if (!entry.is_directory())
+		{
+			continue;
+		}
+		const fs::path region = entry.path().filename();
+		for (const char* field : {"T", "rho"})
+		{
+			if (fs::is_regular_file(entry.path()/field))
+			{
+				fs::create_directories(iterDir/region);
+				fs::copy_file(entry.path()/field, iterDir/region/field, fs::copy_options::overwrite_existing);
+			}
+		}
+	}
+}
+
+
+// Drop the schedule of iterations after iter, neutronSchedule of the next
+// iteration already ran when the loop stops on convergence
+void rollbackSchedule(const fs::path& caseDir, int iter, const fs::path& iterDir)
+{
+	const fs::path historyFile = caseDir/"neutronHistory";
+	std::ifstream is(historyFile);
+	std::string line, history;
+	while (std::getline(is, line))
+	{
+		std::istringstream ls(line);
+		int loop = 0;
+		if (line.empty() || line[0] == '#' || ((ls >> loop) && loop <= iter))
+		{
+			history += line + "\n";
+		}
+	}
+	is.close();
+	writeFile(historyFile, history);
+
+	fs::copy_file(iterDir/"neutronPlan", caseDir/"neutronPlan", fs::copy_options::overwrite_existing);
+}
+
+
+// Report a failed stage, the caller returns from main so that running
+// stages are joined and destructors run in order
+void failure(const std::string& what, const std::string& log)
+{
+	std::cerr
+		<< "\n******************************************\n"
+		<< "*  " << what << "\n"
+		<< "*  check " << log << "\n"
+		<< "******************************************\n";
+}
+
+
+void printUsage(const char* exe)
+{
+	std::cout << "Usage: " << exe << " [options]\n"
+		<< "Options:\n"
+		<< "  -h, --help          Show this help message and exit\n"
+		<< "  -v, --version       Show version information and exit\n"
+		<< "  -s <file>           Settings file, default settings.sh\n"
+		<< "  -I, --interactive   Run gnuplot with run-time info\n";
+}
+
+
+int main(int argc, char* argv[])
+{
+	fs::path settingsFile = "settings.sh";
+	bool interactive = false;
+
+	for (int a=1; a<argc; a++)
+	{
+		const std::string arg = argv[a];
+		if (arg == "-h" || arg == "--help")
+		{
+			printUsage(argv[0]);
+			return 0;
+		}
+		else if (arg == "-v" || arg == "--version")
+		{
+			std::cout << "JMTCS version 1.0.0\n";
+			return 0;
+		}
+		else if (arg == "-I" || arg == "--interactive")
+		{
+			interactive = true;
+		}
+		else if (arg == "-s" && a+1 < argc)
+		{
+			settingsFile = argv[++a];
+		}
+		else
+		{
+			std::cerr << "Unknown option: " << arg << "\n";
+			printUsage(argv[0]);
+			return 1;
+		}
+	}
+
+	std::cout << "\n******************************************\n"
+		<< "*              Running JMTCS             *\n"
+		<< "******************************************\n\n";
+
+	Settings s;
+	if (!readSettings(settingsFile, s))
+	{
+		return 1;
+	}
+
+	const fs::path caseDir = s.openfoamFolder;
+	const std::string env = foamEnv(s);
+	Timeline timeline;
+
+	std::cout << "Number of Picard iterations: " << s.nLoops << "\n";
+
+	// Serpent input of the first iteration
+	Plan plan;
+	{
+		StageTimer t(timeline, 1, "prepare");
+		if (!prepareSerpent(s, 1, latestTime(caseDir), plan))
+		{
+			return 1;
+		}
+	}
+
+	for (int i=1; i<=s.nLoops; i++)
+	{
+		std::cout << "\n******************************************\n"
+			<< "*             Iteration " << i << "               *\n"
+			<< "******************************************\n\n";
+
+		const fs::path iterDir = std::to_string(i);
+		fs::remove_all(iterDir);
+		fs::create_directory(iterDir);
+
+		// Plan of this iteration, neutronSchedule of the next one rewrites it
+		// while this iteration is still running
+		fs::copy_file(caseDir/"neutronPlan", iterDir/"neutronPlan", fs::copy_options::overwrite_existing);
+
+		std::cout << "Current relaxation factor " << plan.alpha
+			<< " and simulated neutrons " << plan.neutrons << "\n";
+
+		if (interactive)
+		{
+			run("command -v gnuplot > /dev/null && (gnuplot -e \"log='log.gnuplot'\" plot - &> /dev/null &)");
+		}
+
+		// Mesh and 0/ decomposition does not depend on Serpent, it runs
+		// alongside. constant/ is left out, Serpent writes volPower there and
+		// isBoundarySet.sh fixes it afterwards, the processor volPower is
+		// written by powerRelax -regions.
+		std::future<int> decompose;
+		if (i == 1 || !fs::is_directory(caseDir/"processor0"))
+		{
+			decompose = std::async(std::launch::async, [&]()
+			{
+				StageTimer t(timeline, i, "decompose");
+				return run(env + "decomposePar -force -allRegions > log.decomposePar 2>&1", caseDir);
+			});
+		}
+
+		{
+			StageTimer t(timeline, i, "serpent");
+			std::cout << "Serpent loop\n";
+			const std::string cmd = "'" + s.serpent + "' " + s.serpentInput + " -omp "
+				+ std::to_string(s.nProcs) + " > log.serpent 2>&1";
+			if (run(cmd) != 0)
+			{
+				if (decompose.valid())
+				{
+					decompose.wait();
+				}
+				failure("Serpent stopped working!", "log.serpent");
+				return 1;
+			}
+		}
+
+		if (interactive)
+		{
+			run("pkill -x gnuplot &> /dev/null");
+		}
+
+		if (decompose.valid() && decompose.get() != 0)
+		{
+			failure("decomposePar failed!", caseDir.string() + "/log.decomposePar");
+			return 1;
+		}
+
+		std::cout << "OpenFOAM loop\n";
+		run("./isBoundarySet.sh > log.setBoundary 2>&1", caseDir);
+
+		{
+			StageTimer t(timeline, i, "relax");
+			std::string cmd = env + "powerRelax -alphaRelax " + plan.alpha + " -regions '(";
+			for (const std::string& r : s.fuelOpenfoam)
+			{
+				cmd += r + " ";
+			}
+			cmd += ")'";
+			if (i == 1)
+			{
+				cmd += " -first";
+			}
+			if (!s.relaxAcceleration.empty())
+			{
+				cmd += " -acceleration " + s.relaxAcceleration;
+			}
+			if (run(cmd + " > log.powerRelax 2>&1", caseDir) != 0)
+			{
+				failure("powerRelax failed!", caseDir.string() + "/log.powerRelax");
+				return 1;
+			}
+			run("grep '^Residual' log.powerRelax", caseDir);
+		}
+
+		const std::string startTime = latestTime(caseDir);
+		std::ostringstream endTime;
+		endTime << std::stol(startTime) + s.openfoamIterations;
+		setControlDict(caseDir, "endTime", endTime.str());
+		setControlDict(caseDir, "stopAt", "endTime");
+
+		if (interactive)
+		{
+			run("command -v gnuplot > /dev/null && (gnuplot -e \"log='log.gnuplot'\" plot - &> /dev/null &)");
+		}
+
+		{
+			StageTimer t(timeline, i, "solve");
+			if (run(env + "foamJob -p -w chtMultiRegionSimpleFoam > /dev/null 2>&1", caseDir) != 0)
+			{
+				failure("OpenFOAM is not working!", "log in " + s.openfoamFolder);
+				return 1;
+			}
+		}
+
+		if (interactive)
+		{
+			run("pkill -x gnuplot &> /dev/null");
+		}
+
+		// Next Serpent input is prepared while the fields are reconstructed,
+		// the solver normally stops at endTime
+		Plan nextPlan;
+		std::future<bool> prepareNext;
+		if (i < s.nLoops)
+		{
+			prepareNext = std::async(std::launch::async, [&]()
+			{
+				StageTimer t(timeline, i, "prepare");
+				return prepareSerpent(s, i+1, endTime.str(), nextPlan);
+			});
+		}
+
+		{
+			StageTimer t(timeline, i, "reconstruct");
+			if (run(env + "reconstructPar -latestTime -allRegions > log.reconstructPar 2>&1", caseDir) != 0)
+			{
+				if (prepareNext.valid())
+				{
+					prepareNext.wait();
+				}
+				failure("reconstructPar failed!", caseDir.string() + "/log.reconstructPar");
+				return 1;
+			}
+		}
+
+		{
+			StageTimer t(timeline, i, "copy");
+			copyGlob(caseDir, "log", iterDir);
+			for (const std::string& r : s.fuelOpenfoam)
+			{
+				fs::copy_file(caseDir/"constant"/r/"volPower", iterDir/"volPower", fs::copy_options::overwrite_existing);
+			}
+			copyGlob(".", s.serpentInput + "_mesh", iterDir);
+			copyGlob(".", s.serpentInput + "_geom", iterDir);
+			fs::copy_file("log.serpent", iterDir/"log.serpent", fs::copy_options::overwrite_existing);
+			copyFields(s, caseDir, latestTime(caseDir), iterDir);
+		}
+
+		if (prepareNext.valid())
+		{
+			if (!prepareNext.get())
+			{
+				return 1;
+			}
+			plan = nextPlan;
+
+			// Solver stopped before endTime, interface files need the real time
+			const std::string reconstructed = latestTime(caseDir);
+			if (reconstructed != endTime.str())
+			{
+				prepareIfc(s, reconstructed);
+			}
+		}
+
+		// Stop the loop when system/convergenceDict criteria are met
+		int convergence = 2;
+		if (fs::is_regular_file(caseDir/"system"/"convergenceDict"))
+		{
+			StageTimer t(timeline, i, "convergence");
+			convergence = run
+			(
+				env + "convergenceMonitor -case '" + s.openfoamFolder + "' -loop " + std::to_string(i)
+				+ " -iterations '" + fs::current_path().string() + "' > log.convergenceMonitor 2>&1"
+			);
+			fs::copy_file("log.convergenceMonitor", iterDir/"log.convergenceMonitor", fs::copy_options::overwrite_existing);
+			run("grep -E 'converged$' log.convergenceMonitor");
+			if (convergence == 1)
+			{
+				std::cout << "convergenceMonitor failed, check log.convergenceMonitor\n";
+			}
+		}
+
+		timeline.write(i, iterDir/"timeline.json", "timeline.json");
+
+		if (convergence == 0)
+		{
+			std::cout << "\nPicard loop converged in iteration " << i << "\n";
+			if (i < s.nLoops)
+			{
+				rollbackSchedule(caseDir, i, iterDir);
+			}
+			break;
+		}
+	}
+
+	std::cout << "\nSimulation finished\n\n";
+	return 0;
+}
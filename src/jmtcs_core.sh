@@ -42,6 +42,36 @@ copy_results() {
     cp ${SERPENT_INPUT}_mesh* $i/
     cp ${SERPENT_INPUT}_geom* $i/
     cp log.serpent $i/
+    cp $OPENFOAM_FOLDER/neutronPlan $i/
+    # fields of the iteration for convergenceMonitor
+    for of_region in ${FUEL_OPENFOAM[@]}; do
+        mkdir -p $i/$of_region
+        cp $OPENFOAM_FOLDER/constant/$of_region/volPower $i/$of_region/
+    done
+    for region_dir in $OPENFOAM_FOLDER/$saveTime/*/; do
+        of_region=$(basename $region_dir)
+        mkdir -p $i/$of_region
+        for field in T rho; do
+            if [ -f $region_dir/$field ]; then
+                cp $region_dir/$field $i/$of_region/
+            fi
+        done
+    done
+}
+
+check_convergence() {
+    # Stop the loop when system/convergenceDict criteria are met
+    if [ ! -f $OPENFOAM_FOLDER/system/convergenceDict ]; then
+        return 1
+    fi
+    convergenceMonitor -case $OPENFOAM_FOLDER -loop $i -iterations $PWD > log.convergenceMonitor
+    status=$?
+    cp log.convergenceMonitor $i/
+    grep -E "converged$" log.convergenceMonitor
+    if (( status == 1 )); then
+        echo "convergenceMonitor failed, check log.convergenceMonitor"
+    fi
+    return $status
 }
 
 copy_ifc_files()  {
@@ -66,28 +96,44 @@ copy_input_file() {
 }
 
 power_relaxation() {
-    # Run power relaxation
-    for of_region in ${FUEL_OPENFOAM[@]}; do
-        
-        cp constant/$of_region/volPower $latestTime/$of_region/volPower
-        cp constant/$of_region/volPower $latestTime/$of_region/volPower_S
-        
-        if (($i == 1)); 
-        then
-            cp constant/$of_region/volPower $latestTime/$of_region/volPower_0
-        else
-            secondTime=$(foamListTimes -withZero -latestTime | tail -n 2 | head -n 1)
-            cp $secondTime/$of_region/volPower $latestTime/$of_region/volPower_0
-        fi
-        
-        # Volumetric power manipulation
-        sed -i "s/volPower/volPower_0/" $latestTime/$of_region/volPower_0
-        sed -i "s/volPower/volPower_S/" $latestTime/$of_region/volPower_S
-        # Execute power relaxation
-        powerRelax -alphaRelax $currentAlpha -region $of_region > log.powerRelax -latestTime
-        # Copy relaxed power to constant folder
-        cp $latestTime/$of_region/volPower constant/$of_region/
-    done
+    # Run power relaxation of all fuel regions in one process. The Serpent
+    # power constant/<region>/volPower is blended with the relaxed power of
+    # the previous iteration constant/<region>/volPower_0 and written to
+    # constant/<region> and to existing processor*/constant/<region>
+    # RELAX_ACCELERATION (aitken or anderson) replaces the fixed blend
+    first_flag=""
+    if (($i == 1)); then
+        first_flag="-first"
+    fi
+    accel_flag=""
+    if [ -n "$RELAX_ACCELERATION" ]; then
+        accel_flag="-acceleration $RELAX_ACCELERATION"
+    fi
+    powerRelax -alphaRelax $currentAlpha -regions "(${FUEL_OPENFOAM[*]})" $first_flag $accel_flag > log.powerRelax || {
+        echo "powerRelax failed, check log.powerRelax"
+        exit 1
+    }
+    grep "^Residual" log.powerRelax
+}
+
+schedule_neutrons() {
+    # Number of neutrons and relaxation factor of the actual iteration. With
+    # TARGET_RELERR the neutrons follow the Serpent relative error of the
+    # previous iteration, NEUTRON_BUDGET limits the particles of the whole run
+    schedule_args=(-case $OPENFOAM_FOLDER -loop $i -initNeutrons $N_INIT_NEUTRONS -loops $N_LOOPS)
+    schedule_args+=(-regions "(${FUEL_OPENFOAM[*]})")
+    if [ -n "$TARGET_RELERR" ]; then
+        schedule_args+=(-targetRelErr $TARGET_RELERR)
+    fi
+    if [ -n "$NEUTRON_BUDGET" ]; then
+        schedule_args+=(-budget $NEUTRON_BUDGET)
+    fi
+    neutronSchedule "${schedule_args[@]}" > log.neutronSchedule || {
+        echo "neutronSchedule failed, check log.neutronSchedule"
+        exit 1
+    }
+    currentNeutrons=$(awk '$1 == "neutrons" {print $2}' $OPENFOAM_FOLDER/neutronPlan)
+    currentAlpha=$(awk '$1 == "alpha" {print $2}' $OPENFOAM_FOLDER/neutronPlan)
 }
 
 read_settings() {
@@ -244,7 +290,7 @@ main() {
         echo
 
         # Calculate value of alpha_actual
-        read -r currentAlpha currentNeutrons < <(./alphaSet $i $N_INIT_NEUTRONS)
+        schedule_neutrons
         echo "Current relaxation factor $currentAlpha and simulated neutrons $currentNeutrons"
         echo
         # Run serpent
@@ -306,6 +352,15 @@ main() {
         cd $OPENFOAM_FOLDER
         ./isBoundarySet.sh > log.setBoundary
 
+        # Decompose only once, later iterations continue from the processor
+        # directories and powerRelax updates volPower there
+        if (( i == 1 )) || [ ! -d processor0 ]; then
+            decomposePar -force -allRegions -constant > log.decomposePar || {
+                echo "decomposePar failed, check log.decomposePar"
+                exit 1
+            }
+        fi
+
         # Relaxation of power distribution
         power_relaxation
         
@@ -319,9 +374,6 @@ main() {
         
 
 
-        # Decompose and volPower manipulation for processors
-        decomposePar -force -allRegions -constant > log.decomposePar
-
         # Start gnuplot if interactive mode is set and it exist
         if $interactive_mode_placeholder; then
             interactive_mode
@@ -355,6 +407,12 @@ main() {
 
         # Copy results
         copy_results
+
+        if check_convergence; then
+            echo
+            echo "Picard loop converged in iteration $i"
+            break
+        fi
     done
 
     echo